@@ -0,0 +1,69 @@
+import socket
+import struct
+import sys
+
+# Mirrors src/protocol.hpp: id, op, 3 padding bytes, payload length
+HEADER = struct.Struct("=IB3xI")
+
+ENCODE, DECODE, COUNT, STATS, RELOAD = range(5)
+
+
+class BPEClient:
+    def __init__(self, path="bpe.sock"):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.next_id = 0
+
+    def _read(self, size):
+        data = bytearray()
+        while len(data) < size:
+            chunk = self.sock.recv(size - len(data))
+            if not chunk:
+                raise ConnectionError("Lost connection to the server")
+            data += chunk
+        return bytes(data)
+
+    def _request(self, op, payload=b""):
+        self.sock.sendall(HEADER.pack(self.next_id, op, len(payload)) + payload)
+        self.next_id = (self.next_id + 1) & 0xFFFFFFFF
+
+        _, status, length = HEADER.unpack(self._read(HEADER.size))
+        response = self._read(length)
+        if status != 0:
+            raise RuntimeError(response.decode(errors="replace"))
+        return response
+
+    def encode(self, text):
+        response = self._request(ENCODE, text.encode())
+        return list(struct.unpack(f"={len(response) // 4}I", response))
+
+    def decode(self, tokens):
+        response = self._request(DECODE, struct.pack(f"={len(tokens)}I", *tokens))
+        return response.decode(errors="replace")
+
+    def count(self, text):
+        return struct.unpack("=I", self._request(COUNT, text.encode()))[0]
+
+    def stats(self):
+        return self._request(STATS).decode()
+
+    def reload(self, path=""):
+        self._request(RELOAD, path.encode())
+
+    def close(self):
+        self.sock.close()
+
+
+if __name__ == "__main__":
+    # Usage: python3 bpeclient.py encode|count|stats|reload [socket path] < text
+    command = sys.argv[1] if len(sys.argv) > 1 else "encode"
+    client = BPEClient(sys.argv[2] if len(sys.argv) > 2 else "bpe.sock")
+
+    if command == "stats":
+        print(client.stats())
+    elif command == "reload":
+        client.reload()
+    elif command == "count":
+        print(client.count(sys.stdin.read()))
+    else:
+        print(" ".join(map(str, client.encode(sys.stdin.read()))))
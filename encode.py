@@ -1,16 +1,13 @@
-from pybpe import BPE
+from pybpe import BPE, StreamDecoder
 
 bpe = BPE()
 bpe.load("tokenizer.bpe")
 
 while True:
     encoded = bpe.encode(input("Text:\n"))
-    decoded_list = []
-    for token in encoded:
-        try:
-            decoded_list.append(bpe.decode([token]))
-        except: # UnicodeDecodeError
-            decoded_list.append('� ')
+    decoder = StreamDecoder(bpe)
+    decoded_list = [decoder.decode(token) for token in encoded]
+    decoded_list.append(decoder.flush())
 
     decoded = bpe.decode(encoded)
 
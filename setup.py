@@ -4,7 +4,7 @@ from pybind11.setup_helpers import Pybind11Extension, build_ext
 ext_modules = [
     Pybind11Extension(
         "pybpe",
-        ["src/pywrap.cpp", "src/bpe.cpp"],
+        ["src/pywrap.cpp", "src/bpe.cpp", "src/streamdecoder.cpp"],
         include_dirs=["src/"],
         extra_compile_args=['-std=c++23', '-O3'],
         extra_link_args=[],
@@ -0,0 +1,59 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "bpe.hpp"
+#include "merge.hpp"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+int main(){
+    string filePath;
+
+    cout << "Type in (or paste in) the path to the text file to encode:" << endl;
+    getline(cin, filePath);
+
+    ifstream file(filePath, ios::binary);
+    if(!file.is_open()){
+        cerr << "Could not open file: " << filePath << endl;
+        return -1;
+    }
+    string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    file.close();
+
+    BPE bpe;
+    bpe.Load("tokenizer.bpe");
+
+    cout << "Small word size: " << BPE_SMALL_WORD_SIZE << endl;
+
+    /* Encode the file until at least a second has passed, so small files still give stable numbers */
+    size_t runs = 0, tokens = 0;
+    auto start = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed{};
+    while(elapsed.count() < 1.0){
+        tokens += bpe.EncodeToVector(text).size();
+        ++runs;
+        elapsed = chrono::high_resolution_clock::now() - start;
+    }
+
+    cout << runs << " runs, " << tokens / runs << " tokens per run" << endl
+        << (size_t)(tokens / elapsed.count()) << " tokens/s" << endl
+        << text.size() * runs / elapsed.count() / (1 << 20) << " MiB/s" << endl;
+}
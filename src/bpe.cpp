@@ -18,12 +18,19 @@
 
 #include "bpe.hpp"
 #include "datastructures.hpp"
+#include "merge.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <fstream>
 #include <iostream>
+#include <queue>
 
 using namespace std;
 
+/* Appended to the vocab size line of a .bpe file when it uses line documents */
+constexpr char LINE_DOCUMENTS_FLAG[] = " lines";
+
 void ReadFile(const string& path, string& output){
     ifstream file(path, ios::binary);
 
@@ -36,6 +43,34 @@ void ReadFile(const string& path, string& output){
     file.close();
 }
 
+void SampleFile(const string& path, const size_t sampleSize, string& output){
+    ifstream file(path, ios::binary);
+
+    if (!file.is_open()) {
+        cerr << "Could not open file: " << path << endl;
+        exit(-1);
+    }
+
+    file.seekg(0, ios::end);
+    size_t fileSize = file.tellg();
+    file.seekg(0, ios::beg);
+
+    double ratio = fileSize > sampleSize ? (double)sampleSize / fileSize : 1.0;
+    output.reserve(min(sampleSize, fileSize));
+
+    /* Stride sampling over lines (documents): keep a line whenever the sample falls behind the target ratio */
+    size_t seen = 0;
+    string line;
+    while(getline(file, line)){
+        seen += line.size() + 1;
+        if(output.size() < ratio * seen){
+            output.append(line);
+            output.push_back('\n');
+        }
+    }
+    file.close();
+}
+
 void CountTokens(const TokenList& tokens, Heap& heap){
     TokenNode* token = tokens.head();
     while(token->next != nullptr){
@@ -54,9 +89,12 @@ void BPE::BuildVocab(){
         m_Vocab[i] = string(1, i);
     }
 
+    m_MergeRanks.clear();
+    m_MergeRanks.reserve(m_VocabSize - 256);
     for(size_t i = 256; i < m_VocabSize; ++i){
         TokenPair pair = m_Merges[i-256];
         m_Vocab[i] = (m_Vocab[pair.token1] + m_Vocab[pair.token2]);
+        m_MergeRanks.try_emplace(pair, i);
     }
     cout << "Vocab built." << endl;
 }
@@ -68,94 +106,131 @@ void BPE::LoadSplitLetters(const string& splitLetters){
     }
 }
 
-void BPE::Load(const string& path){
+bool BPE::TryLoad(const string& path, string& error){
     ifstream file;
 
     file.open(path);
 
     if(!file.is_open()){
-        cout << "Could not open file: " << path << endl;
-        exit(-1);
+        error = "Could not open file: " + path;
+        return false;
     }
 
-    {
-        /* Load regex pattern */
-        string splitLetterText;
-        getline(file, splitLetterText);
-        cout << splitLetterText << endl;
-
-        LoadSplitLetters(splitLetterText);
-    }
+    /* Everything is parsed and checked before this BPE changes, so a broken file leaves it as it was */
+    string splitLetterText;
+    getline(file, splitLetterText);
 
+    /* The vocab size line ends with " lines" for tokenizers fitted with line documents */
+    size_t vocabSize;
+    bool lineDocuments;
     {
-        /* Load vocab size */
         string vocabSizeString;
         getline(file, vocabSizeString);
 
-        m_VocabSize = stoi(vocabSizeString);
-
-        cout << to_string(m_VocabSize) << endl;
+        const char* end = vocabSizeString.data() + vocabSizeString.size();
+        auto [ptr, ec] = from_chars(vocabSizeString.data(), end, vocabSize);
+        lineDocuments = string_view(ptr, end - ptr) == LINE_DOCUMENTS_FLAG;
+        if(ec != errc() || (ptr != end && !lineDocuments) || vocabSize < 256 || vocabSize > UINT32_MAX){
+            error = "Invalid vocab size: \"" + vocabSizeString + "\"";
+            return false;
+        }
     }
 
-    {
-        /* Load pairs */
-        m_Merges.reserve(m_VocabSize - 256);
-        while(true){
-            string idx1String, idx2String;
-            if(!getline(file, idx1String, ' ') || !getline(file, idx2String, '\n')){
-                break;
-            }
+    vector<TokenPair> merges;
+    merges.reserve(vocabSize - 256);
+    /* Which tokens contain a document separator, to find merges that continue past one */
+    vector<bool> hasSeparator(256, false);
+    hasSeparator[DOCUMENT_SEPARATOR] = true;
+    string line;
+    while(getline(file, line) && !line.empty()){
+        const char* end = line.data() + line.size();
+        TokenPair pair;
+        auto [ptr1, ec1] = from_chars(line.data(), end, pair.token1);
+        auto [ptr2, ec2] = ec1 == errc() && ptr1 != end && *ptr1 == ' '
+            ? from_chars(ptr1 + 1, end, pair.token2)
+            : from_chars_result{ptr1, errc::invalid_argument};
+        if(ec2 != errc() || ptr2 != end){
+            error = "Invalid merge " + to_string(merges.size()) + ": \"" + line + "\"";
+            return false;
+        }
 
-            m_Merges.push_back({
-                (uint32_t)stoi(idx1String),
-                (uint32_t)stoi(idx2String)
-            });
+        /* A merge can only use bytes and the tokens built by the merges before it */
+        const uint32_t newToken = 256 + merges.size();
+        if(pair.token1 >= newToken || pair.token2 >= newToken){
+            error = "Merge " + to_string(merges.size()) + " uses a token that doesn't exist yet: \"" + line + "\"";
+            return false;
+        }
+
+        if(lineDocuments && hasSeparator[pair.token1]){
+            error = "Merge " + to_string(merges.size()) + " continues past a line break, but the file uses line documents: \"" + line + "\"";
+            return false;
+        }
+
+        merges.push_back(pair);
+        hasSeparator.push_back(hasSeparator[pair.token1] || hasSeparator[pair.token2]);
+        if(merges.size() > vocabSize - 256){
+            break;
         }
     }
     file.close();
 
-    BuildVocab();
-}
+    if(merges.size() != vocabSize - 256){
+        error = "Expected " + to_string(vocabSize - 256) + " merges, found " + (merges.size() > vocabSize - 256 ? "more" : to_string(merges.size()));
+        return false;
+    }
 
-TokenList BPE::Encode(const std::string& text) const{
-    TokenList tokens;
-    StringToTokens(text, tokens);
+    cout << splitLetterText << endl;
+    cout << to_string(vocabSize) << (lineDocuments ? LINE_DOCUMENTS_FLAG : "") << endl;
 
-    /* Slow implementation */
-    for(size_t i = 256; i < m_VocabSize; ++i){
-        const TokenPair& merge = m_Merges[i-256];
-        TokenNode* token = tokens.head();
-        while(token != nullptr && token->next != nullptr){
-            if(token->val == 0){
-                tokens.Remove(token);
-                continue;
-            }
+    m_SplitLetters.clear();
+    LoadSplitLetters(splitLetterText);
+    m_VocabSize = vocabSize;
+    m_LineDocuments = lineDocuments;
+    m_Merges = std::move(merges);
 
-            if(merge.token1 == token->val && merge.token2 == token->next->val){
-                token->val = i;
-                tokens.Remove(token->next);
-            }
+    BuildVocab();
+    return true;
+}
 
-            token = token->next;
-        }
+void BPE::Load(const string& path){
+    string error;
+    if(!TryLoad(path, error)){
+        cerr << error << endl;
+        exit(-1);
     }
+}
+
+template<typename EmitFn>
+void BPE::MergeText(const string& text, const EmitFn& emit) const{
+    ::MergeText(text,
+        [this](unsigned char c){ return m_SplitLetters.find(c) != m_SplitLetters.end(); },
+        m_LineDocuments,
+        [this](uint32_t token1, uint32_t token2){
+            auto iter = m_MergeRanks.find({token1, token2});
+            return iter == m_MergeRanks.end() ? NO_MERGE : iter->second;
+        },
+        emit
+    );
+}
+
+TokenList BPE::Encode(const std::string& text) const{
+    TokenList tokens;
+    MergeText(text, [&tokens](uint32_t token){ tokens.Append(token); });
     return tokens;
 }
 
 std::vector<uint32_t> BPE::EncodeToVector(const std::string& text) const{
-    TokenList tokenList = Encode(text);
     vector<uint32_t> tokens;
-
-    TokenNode* token = tokenList.head();
-    while(token != nullptr){
-        tokens.push_back(token->val);
-        token = token->next;
-    }
-
-    tokenList.DeleteContents();
+    MergeText(text, [&tokens](uint32_t token){ tokens.push_back(token); });
     return tokens;
 }
 
+size_t BPE::Count(const std::string& text) const{
+    size_t count = 0;
+    MergeText(text, [&count](uint32_t){ ++count; });
+    return count;
+}
+
 string BPE::Decode(const TokenList& tokens) const{
     string result;
     TokenNode* token = tokens.head();
@@ -176,29 +251,20 @@ string BPE::DecodeFromVector(const vector<uint32_t>& tokens) const{
 }
 
 void BPE::StringToTokens(const string& data, TokenList& tokens) const{
+    bool newDocument = false;
     for(unsigned char c : data){
-        if(m_SplitLetters.find(c) != m_SplitLetters.end()){
-            tokens.Append(0);
+        if(newDocument || m_SplitLetters.find(c) != m_SplitLetters.end()){
+            tokens.Append(WORD_BOUNDARY);
         }
         tokens.Append(c);
+        newDocument = m_LineDocuments && c == DOCUMENT_SEPARATOR;
         /* Why the need for all this complicated Regex? */
         /* This is much faster, higly parallelizable (thanks to the linked list), but still upgradeable */
         /* (Unicode support coming soon :P) */
     }
 }
 
-void BPE::Fit(const size_t vocabSize, const std::string& path){
-    m_VocabSize = vocabSize;
-
-    TokenList tokens;
-    {
-        string data;
-        ReadFile(path, data);
-        cout << "File read! :P" << path << endl;
-        StringToTokens(data, tokens);
-    }
-    cout << "Tokens loaded! :P" << endl;
-
+void BPE::FitTokens(TokenList& tokens, const std::string& tokensPath){
     Heap heap;
     CountTokens(tokens, heap);
 
@@ -209,7 +275,7 @@ void BPE::Fit(const size_t vocabSize, const std::string& path){
     for(uint32_t i = 256; i < m_VocabSize; ++i){
         HeapNode* top = heap.PopTop();
 
-        for(TokenNode* token : top->positions){
+        auto merge = [&heap, &tokens, i](TokenNode* token){
             heap.RemovePosition(token->prev);
             heap.RemovePosition(token->next);
 
@@ -218,11 +284,33 @@ void BPE::Fit(const size_t vocabSize, const std::string& path){
 
             heap.AddPosition(token->prev);
             heap.AddPosition(token);
+        };
+
+        /* Pairs like "aa" overlap in runs like "aaa": only keep run starts and merge each run from the left, like Encode does */
+        const TokenPair pair = top->pair();
+        const bool overlapping = pair.token1 == pair.token2;
+        vector<TokenNode*> positions;
+        positions.reserve(top->positions.size());
+        for(TokenNode* token : top->positions){
+            if(!overlapping || token->prev == nullptr || token->prev->val != pair.token1){
+                positions.push_back(token);
+            }
         }
 
-        m_Merges.push_back(top->pair());
+        /* Removed first, so the merges below can't update the positions of the popped node */
         heap.RemoveNode(top);
 
+        for(TokenNode* token : positions){
+            merge(token);
+            while(overlapping && token->next != nullptr && token->next->next != nullptr &&
+                token->next->val == pair.token1 && token->next->next->val == pair.token1){
+                token = token->next;
+                merge(token);
+            }
+        }
+
+        m_Merges.push_back(pair);
+
         if(i % 100 == 0){
             cout << "Token " << i << " reached." << endl;
         }
@@ -237,18 +325,297 @@ void BPE::Fit(const size_t vocabSize, const std::string& path){
     }
 
     heap.DeleteContents();
+
+    BuildVocab();
+
+    if(!tokensPath.empty()){
+        WriteTokens(tokens, tokensPath);
+    }
     tokens.DeleteContents();
+}
+
+void BPE::WriteTokens(const TokenList& tokens, const string& path) const{
+    cout << "Writing tokens..." << endl;
+    ofstream file(path, ios::binary);
+    ofstream index;
+    if(m_LineDocuments){
+        index.open(path + ".idx", ios::binary);
+    }
 
+    if(!file.is_open() || (m_LineDocuments && !index.is_open())){
+        cerr << "Could not open file: " << path << endl;
+        exit(-1);
+    }
+
+    /* The tokens go to path and, with line documents, the token offset where each line (document) ends goes to path.idx */
+    vector<uint32_t> buffer;
+    buffer.reserve(1 << 16);
+    uint64_t count = 0, lastEnd = 0;
+
+    TokenNode* token = tokens.head();
+    while(token != nullptr){
+        if(token->val != WORD_BOUNDARY){
+            buffer.push_back(token->val);
+            ++count;
+
+            /* Tokens never cross a document separator, so it can only be the last letter */
+            if(m_LineDocuments && m_Vocab[token->val].back() == DOCUMENT_SEPARATOR){
+                index.write((const char*)&count, sizeof(count));
+                lastEnd = count;
+            }
+
+            if(buffer.size() == buffer.capacity()){
+                file.write((const char*)buffer.data(), buffer.size() * sizeof(uint32_t));
+                buffer.clear();
+            }
+        }
+        token = token->next;
+    }
+
+    file.write((const char*)buffer.data(), buffer.size() * sizeof(uint32_t));
+    if(m_LineDocuments && count > lastEnd){
+        index.write((const char*)&count, sizeof(count));
+    }
+
+    file.close();
+    if(m_LineDocuments){
+        index.close();
+    }
+    cout << "Wrote " << count << " tokens." << endl;
+}
+
+void BPE::Fit(const size_t vocabSize, const std::string& path, const std::string& tokensPath){
+    m_VocabSize = vocabSize;
+
+    TokenList tokens;
+    {
+        string data;
+        ReadFile(path, data);
+        cout << "File read! :P" << path << endl;
+        StringToTokens(data, tokens);
+    }
+    cout << "Tokens loaded! :P" << endl;
+
+    FitTokens(tokens, tokensPath);
+}
+
+void BPE::FitSampled(const size_t vocabSize, const std::string& path, const size_t sampleSize, const size_t refineTopK){
+    m_VocabSize = vocabSize;
+
+    TokenList tokens;
+    {
+        string data;
+        SampleFile(path, sampleSize, data);
+        cout << "File sampled! :P " << data.size() << " bytes" << endl;
+        StringToTokens(data, tokens);
+    }
+    cout << "Tokens loaded! :P" << endl;
+
+    FitTokens(tokens);
+
+    if(refineTopK > 0){
+        RefineMerges(path, refineTopK);
+    }
+}
+
+/* Streams the file in line-aligned chunks, so it never has to fit in memory */
+template<typename ChunkFn>
+void ForEachChunk(const string& path, const ChunkFn& process){
+    ifstream file(path, ios::binary);
+
+    if (!file.is_open()) {
+        cerr << "Could not open file: " << path << endl;
+        exit(-1);
+    }
+
+    const size_t chunkSize = 64 << 20;
+    string chunk, line;
+    while(getline(file, line)){
+        chunk.append(line);
+        chunk.push_back(DOCUMENT_SEPARATOR);
+        if(chunk.size() >= chunkSize){
+            process(chunk);
+            chunk.clear();
+        }
+    }
+    if(!chunk.empty()){
+        process(chunk);
+    }
+    file.close();
+}
+
+void BPE::CountWords(const string& data, unordered_map<string, size_t>& words) const{
+    size_t wordStart = 0;
+    for(size_t i = 1; i <= data.size(); ++i){
+        if(i == data.size() || m_SplitLetters.find((unsigned char)data[i]) != m_SplitLetters.end() ||
+            (m_LineDocuments && data[i-1] == DOCUMENT_SEPARATOR)){
+            ++words[data.substr(wordStart, i - wordStart)];
+            wordStart = i;
+        }
+    }
+}
+
+void BPE::RefineMerges(const std::string& path, const size_t topK){
+    const uint32_t numMerges = min(topK, m_Merges.size());
+    cout << "Refining the first " << numMerges << " merges on the full corpus..." << endl;
+
+    /* Words repeat a lot, so the greedy selection below runs on the distinct words of the whole file */
+    vector<vector<uint32_t>> words;
+    vector<size_t> frequencies;
+    {
+        unordered_map<string, size_t> wordCounts;
+        ForEachChunk(path, [this, &wordCounts](const string& chunk){ CountWords(chunk, wordCounts); });
+
+        words.reserve(wordCounts.size());
+        frequencies.reserve(wordCounts.size());
+        for(const auto& [text, frequency] : wordCounts){
+            words.emplace_back((const unsigned char*)text.data(), (const unsigned char*)text.data() + text.size());
+            frequencies.push_back(frequency);
+        }
+    }
+
+    /*
+        The first merges decide how most of the text is split, so they are picked again exactly like Fit does,
+        but with the counts of the whole file. Reordering the sample's own pairs doesn't work:
+        the later merges expect the tokens that the sample's order builds.
+    */
+    vector<string> vocab(m_Vocab.begin(), m_Vocab.begin() + 256);
+    unordered_map<string, uint32_t> tokenIds;
+    for(uint32_t i = 0; i < 256; ++i){
+        tokenIds[vocab[i]] = i;
+    }
+    vector<TokenPair> merges;
+
+    struct PairInfo{
+        size_t count;
+        unordered_set<uint32_t> words;
+    };
+    unordered_map<TokenPair, PairInfo> pairs;
+    unordered_set<TokenPair> changed;
+    auto countWord = [&](uint32_t word, bool add){
+        const vector<uint32_t>& tokens = words[word];
+        for(size_t i = 0; i + 1 < tokens.size(); ++i){
+            PairInfo& info = pairs[{tokens[i], tokens[i+1]}];
+            if(add){
+                info.count += frequencies[word];
+                info.words.insert(word);
+            } else {
+                info.count -= frequencies[word];
+            }
+            changed.insert({tokens[i], tokens[i+1]});
+        }
+    };
+
+    /* The most frequent pair on top, the counts in it are checked against the current ones when popped */
+    using Entry = pair<size_t, uint64_t>;
+    priority_queue<Entry> queue;
+    auto pushChanged = [&](){
+        for(const TokenPair& pair : changed){
+            queue.push({pairs[pair].count, ((uint64_t)pair.token1 << 32) | pair.token2});
+        }
+        changed.clear();
+    };
+
+    for(uint32_t word = 0; word < words.size(); ++word){
+        countWord(word, true);
+    }
+    pushChanged();
+
+    while(merges.size() < numMerges && !queue.empty()){
+        auto [count, key] = queue.top();
+        queue.pop();
+
+        const TokenPair pair{(uint32_t)(key >> 32), (uint32_t)key};
+        PairInfo& best = pairs[pair];
+        if(count == 0 || count != best.count){
+            continue;
+        }
+
+        const uint32_t merged = vocab.size();
+        merges.push_back(pair);
+        vocab.push_back(vocab[pair.token1] + vocab[pair.token2]);
+        tokenIds.try_emplace(vocab.back(), merged);
+
+        unordered_set<uint32_t> affected;
+        affected.swap(best.words);
+        for(uint32_t word : affected){
+            countWord(word, false);
+
+            /* From the left, like Encode */
+            vector<uint32_t>& tokens = words[word];
+            size_t out = 0;
+            for(size_t i = 0; i < tokens.size(); ++i){
+                if(i + 1 < tokens.size() && tokens[i] == pair.token1 && tokens[i+1] == pair.token2){
+                    tokens[out++] = merged;
+                    ++i;
+                } else {
+                    tokens[out++] = tokens[i];
+                }
+            }
+            tokens.resize(out);
+
+            countWord(word, true);
+        }
+        pushChanged();
+    }
+
+    /* The sample's tokens that weren't built yet follow in the sample's order, with the sample's pairs */
+    for(size_t i = 0; i < m_Merges.size() && merges.size() < m_Merges.size(); ++i){
+        const string& token = m_Vocab[i+256];
+        if(tokenIds.find(token) != tokenIds.end()){
+            continue;
+        }
+
+        auto token1 = tokenIds.find(m_Vocab[m_Merges[i].token1]);
+        auto token2 = tokenIds.find(m_Vocab[m_Merges[i].token2]);
+        if(token1 == tokenIds.end() || token2 == tokenIds.end()){
+            continue;
+        }
+
+        merges.push_back({token1->second, token2->second});
+        vocab.push_back(token);
+        tokenIds[token] = vocab.size() - 1;
+    }
+
+    if(merges.size() < m_Merges.size()){
+        cout << m_Merges.size() - merges.size() << " merges couldn't be built anymore and were dropped." << endl;
+    }
+
+    m_Merges = merges;
+    m_VocabSize = merges.size() + 256;
+
+    cout << "Merges refined." << endl;
     BuildVocab();
 }
 
+size_t BPE::EncodedSize(const std::string& path) const{
+    size_t size = 0;
+    ForEachChunk(path, [this, &size](const string& chunk){
+        size += Count(chunk);
+    });
+    return size;
+}
+
+double BPE::MergeOverlap(const BPE& other) const{
+    unordered_set<string> otherTokens(other.m_Vocab.begin() + 256, other.m_Vocab.end());
+
+    size_t shared = 0;
+    for(size_t i = 256; i < m_VocabSize; ++i){
+        if(otherTokens.find(m_Vocab[i]) != otherTokens.end()){
+            ++shared;
+        }
+    }
+
+    return m_VocabSize > 256 ? (double)shared / (m_VocabSize - 256) : 1.0;
+}
+
 void BPE::Save(const string& path) const{
     cout << "Saving..." << endl;
     ofstream file;
     file.open(path);
 
     file << m_SplitLettersString << "\n";
-    file << to_string(m_VocabSize) << "\n";
+    file << to_string(m_VocabSize) << (m_LineDocuments ? LINE_DOCUMENTS_FLAG : "") << "\n";
 
     for(TokenPair pair : m_Merges){
         file << to_string(pair.token1) << " "
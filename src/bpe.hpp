@@ -25,21 +25,43 @@
 class BPE{
 private:
     std::vector<TokenPair> m_Merges;
+    std::unordered_map<TokenPair, uint32_t> m_MergeRanks;
     std::vector<std::string> m_Vocab;
     size_t m_VocabSize;
+    bool m_LineDocuments = false;
     std::unordered_set<uint32_t> m_SplitLetters;
     std::string m_SplitLettersString;
 
     void StringToTokens(const std::string& data, TokenList& tokens) const;
+    template<typename EmitFn>
+    void MergeText(const std::string& text, const EmitFn& emit) const;
     void BuildVocab();
+    void FitTokens(TokenList& tokens, const std::string& tokensPath = "");
+    void WriteTokens(const TokenList& tokens, const std::string& path) const;
+    void CountWords(const std::string& data, std::unordered_map<std::string, size_t>& words) const;
 public:
+    inline size_t vocabSize() const { return m_VocabSize; }
+    inline const std::vector<std::string>& vocab() const { return m_Vocab; }
+    inline const std::vector<TokenPair>& merges() const { return m_Merges; }
+    inline const std::string& splitLetters() const { return m_SplitLettersString; }
+    inline bool lineDocuments() const { return m_LineDocuments; }
+
+    /* Set before fitting, it is saved with the merges */
+    inline void SetLineDocuments(const bool lineDocuments){ m_LineDocuments = lineDocuments; }
+
     void LoadSplitLetters(const std::string& splitLetters);
     void Load(const std::string& path);
+    bool TryLoad(const std::string& path, std::string& error);
     TokenList Encode(const std::string& text) const;
     std::vector<uint32_t> EncodeToVector(const std::string& text) const;
+    size_t Count(const std::string& text) const;
     std::string Decode(const TokenList& tokens) const;
     std::string DecodeFromVector(const std::vector<uint32_t>& tokens) const;
-    void Fit(const size_t vocabSize, const std::string& path);
+    void Fit(const size_t vocabSize, const std::string& path, const std::string& tokensPath = "");
+    void FitSampled(const size_t vocabSize, const std::string& path, const size_t sampleSize, const size_t refineTopK = 0);
+    void RefineMerges(const std::string& path, const size_t topK);
+    double MergeOverlap(const BPE& other) const;
+    size_t EncodedSize(const std::string& path) const;
     void Save(const std::string& path) const;
 };
 
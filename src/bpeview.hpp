@@ -0,0 +1,122 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BPEVIEW_HPP
+#define BPEVIEW_HPP
+
+#include "merge.hpp"
+#include <algorithm>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+    A tokenizer that reads straight from static tables, like the ones in the headers generated by embed.cpp.
+    Creating one doesn't read files or allocate anything, it only points to the tables.
+*/
+class BPEView{
+private:
+    std::string_view m_SplitLetters;
+    std::span<const bool, 256> m_SplitLetterTable;
+    bool m_LineDocuments;
+    std::span<const TokenPair> m_Merges;
+    /* Sorted (token1 << 32 | token2) keys and the token each pair merges into */
+    std::span<const uint64_t> m_PairKeys;
+    std::span<const uint32_t> m_PairTokens;
+    /* Token i is m_VocabBlob[m_VocabOffsets[i] .. m_VocabOffsets[i+1]] */
+    std::string_view m_VocabBlob;
+    std::span<const uint32_t> m_VocabOffsets;
+
+    inline uint32_t MergeRank(const uint32_t token1, const uint32_t token2) const{
+        const uint64_t key = ((uint64_t)token1 << 32) | token2;
+        auto iter = std::lower_bound(m_PairKeys.begin(), m_PairKeys.end(), key);
+        if(iter == m_PairKeys.end() || *iter != key){
+            return NO_MERGE;
+        }
+        return m_PairTokens[iter - m_PairKeys.begin()];
+    }
+
+    template<typename EmitFn>
+    inline void MergeText(const std::string_view text, const EmitFn& emit) const{
+        ::MergeText(text,
+            [this](unsigned char c){ return m_SplitLetterTable[c]; },
+            m_LineDocuments,
+            [this](uint32_t token1, uint32_t token2){ return MergeRank(token1, token2); },
+            emit
+        );
+    }
+
+public:
+    inline constexpr BPEView(
+        std::string_view splitLetters,
+        std::span<const bool, 256> splitLetterTable,
+        bool lineDocuments,
+        std::span<const TokenPair> merges,
+        std::span<const uint64_t> pairKeys,
+        std::span<const uint32_t> pairTokens,
+        std::string_view vocabBlob,
+        std::span<const uint32_t> vocabOffsets
+    ):m_SplitLetters(splitLetters), m_SplitLetterTable(splitLetterTable), m_LineDocuments(lineDocuments), m_Merges(merges),
+        m_PairKeys(pairKeys), m_PairTokens(pairTokens), m_VocabBlob(vocabBlob), m_VocabOffsets(vocabOffsets){}
+
+    inline constexpr size_t vocabSize() const { return m_VocabOffsets.size() - 1; }
+    inline constexpr std::string_view splitLetters() const { return m_SplitLetters; }
+    inline constexpr bool lineDocuments() const { return m_LineDocuments; }
+    inline constexpr std::span<const TokenPair> merges() const { return m_Merges; }
+
+    inline constexpr std::string_view TokenToString(const uint32_t token) const{
+        return m_VocabBlob.substr(m_VocabOffsets[token], m_VocabOffsets[token+1] - m_VocabOffsets[token]);
+    }
+
+    inline TokenList Encode(const std::string_view text) const{
+        TokenList tokens;
+        MergeText(text, [&tokens](uint32_t token){ tokens.Append(token); });
+        return tokens;
+    }
+
+    inline std::vector<uint32_t> EncodeToVector(const std::string_view text) const{
+        std::vector<uint32_t> tokens;
+        MergeText(text, [&tokens](uint32_t token){ tokens.push_back(token); });
+        return tokens;
+    }
+
+    inline size_t Count(const std::string_view text) const{
+        size_t count = 0;
+        MergeText(text, [&count](uint32_t){ ++count; });
+        return count;
+    }
+
+    inline std::string Decode(const TokenList& tokens) const{
+        std::string result;
+        for(TokenNode* token = tokens.head(); token != nullptr; token = token->next){
+            result.append(TokenToString(token->val));
+        }
+        return result;
+    }
+
+    inline std::string DecodeFromVector(const std::vector<uint32_t>& tokens) const{
+        std::string result;
+        for(const uint32_t& token : tokens){
+            result.append(TokenToString(token));
+        }
+        return result;
+    }
+};
+
+#endif
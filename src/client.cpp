@@ -0,0 +1,108 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "client.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <sys/un.h>
+
+using namespace std;
+
+void BPEClient::Connect(const string& path){
+    m_Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if(m_Socket < 0 || path.size() >= sizeof(address.sun_path)){
+        cerr << "Could not create socket: " << path << endl;
+        exit(-1);
+    }
+
+    path.copy(address.sun_path, path.size());
+
+    if(connect(m_Socket, (sockaddr*)&address, sizeof(address)) < 0){
+        cerr << "Could not connect to: " << path << endl;
+        exit(-1);
+    }
+}
+
+bool BPEClient::Request(const Op op, const void* payload, const size_t size, string& response){
+    RequestHeader request{.id=m_NextId++, .op=op, .padding={}, .length=(uint32_t)size};
+    ResponseHeader header;
+
+    if(!WriteAll(m_Socket, &request, sizeof(request)) ||
+        !WriteAll(m_Socket, payload, size) ||
+        !ReadAll(m_Socket, &header, sizeof(header))){
+        cerr << "Lost connection to the server." << endl;
+        return false;
+    }
+
+    response.resize(header.length);
+    if(!ReadAll(m_Socket, response.data(), response.size())){
+        cerr << "Lost connection to the server." << endl;
+        return false;
+    }
+
+    if(header.status != Status::Ok){
+        cerr << "Server error: " << response << endl;
+        return false;
+    }
+
+    return true;
+}
+
+vector<uint32_t> BPEClient::EncodeToVector(const string& text){
+    string response;
+    vector<uint32_t> tokens;
+    if(Request(Op::Encode, text.data(), text.size(), response)){
+        tokens.resize(response.size() / sizeof(uint32_t));
+        memcpy(tokens.data(), response.data(), tokens.size() * sizeof(uint32_t));
+    }
+    return tokens;
+}
+
+string BPEClient::DecodeFromVector(const vector<uint32_t>& tokens){
+    string response;
+    if(!Request(Op::Decode, tokens.data(), tokens.size() * sizeof(uint32_t), response)){
+        response.clear();
+    }
+    return response;
+}
+
+size_t BPEClient::Count(const string& text){
+    string response;
+    uint32_t count = 0;
+    if(Request(Op::Count, text.data(), text.size(), response) && response.size() == sizeof(count)){
+        memcpy(&count, response.data(), sizeof(count));
+    }
+    return count;
+}
+
+string BPEClient::Stats(){
+    string response;
+    if(!Request(Op::Stats, nullptr, 0, response)){
+        response.clear();
+    }
+    return response;
+}
+
+bool BPEClient::Reload(const string& path){
+    string response;
+    return Request(Op::Reload, path.data(), path.size(), response);
+}
@@ -0,0 +1,48 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLIENT_HPP
+#define CLIENT_HPP
+
+#include "protocol.hpp"
+#include <string>
+#include <vector>
+
+/* Talks to a running server (see server.cpp), one request at a time */
+class BPEClient{
+private:
+    int m_Socket;
+    uint32_t m_NextId;
+
+    bool Request(const Op op, const void* payload, const size_t size, std::string& response);
+public:
+    inline BPEClient():m_Socket(-1), m_NextId(0){}
+    inline ~BPEClient(){ if(m_Socket >= 0) close(m_Socket); }
+
+    BPEClient(const BPEClient&) = delete;
+    BPEClient& operator=(const BPEClient&) = delete;
+
+    void Connect(const std::string& path);
+    std::vector<uint32_t> EncodeToVector(const std::string& text);
+    std::string DecodeFromVector(const std::vector<uint32_t>& tokens);
+    size_t Count(const std::string& text);
+    std::string Stats();
+    bool Reload(const std::string& path = "");
+};
+
+#endif
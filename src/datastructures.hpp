@@ -46,6 +46,9 @@ struct TokenNode{
     TokenNode* next;
 };
 
+/* Separates the words of the token list that Fit merges. It isn't a byte, so a '\0' in the text is just another letter */
+constexpr uint32_t WORD_BOUNDARY = UINT32_MAX;
+
 class TokenList{
 private:
     size_t m_Size;
@@ -264,7 +267,9 @@ public:
         HeapNode* top = m_Nodes[0];
         Swap(top, m_Nodes[size()-1]);
         m_Nodes.pop_back();
-        HeapifyDown(m_Nodes[0]);
+        if(size() > 0){
+            HeapifyDown(m_Nodes[0]);
+        }
         return top;
     }
 
@@ -274,7 +279,7 @@ public:
     }
 
     inline HeapNode* AddPositionNoHeapify(TokenNode* token){
-        if(token == nullptr || token->next == nullptr || token->val == 0 || token->next->val == 0){
+        if(token == nullptr || token->next == nullptr || token->val == WORD_BOUNDARY || token->next->val == WORD_BOUNDARY){
             return nullptr;
         }
 
@@ -304,7 +309,7 @@ public:
     }
 
     inline HeapNode* RemovePositionNoHeapify(TokenNode* token){
-        if(token == nullptr || token->next == nullptr || token->val == 0 || token->next->val == 0){
+        if(token == nullptr || token->next == nullptr || token->val == WORD_BOUNDARY || token->next->val == WORD_BOUNDARY){
             return nullptr;
         }
 
@@ -0,0 +1,148 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "bpe.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+/* Octal escapes always have 3 digits, so a digit right after one can't become part of it */
+void WriteStringLiteral(ofstream& file, const string& text){
+    file << "\"";
+    for(unsigned char c : text){
+        if(c >= 32 && c < 127 && c != '"' && c != '\\' && c != '?'){
+            file << c;
+        } else {
+            file << "\\" << (char)('0' + (c >> 6)) << (char)('0' + ((c >> 3) & 7)) << (char)('0' + (c & 7));
+        }
+    }
+    file << "\"";
+}
+
+template<typename T, typename WriteFn>
+void WriteArray(ofstream& file, const string& type, const string& name, const vector<T>& values, const WriteFn& write){
+    file << "inline constexpr std::array<" << type << ", " << values.size() << "> " << name << "{{";
+    for(size_t i = 0; i < values.size(); ++i){
+        file << (i % 16 == 0 ? "\n    " : " ");
+        write(values[i]);
+        file << ",";
+    }
+    file << "\n}};\n\n";
+}
+
+int main(){
+    string bpePath, name;
+
+    cout << "Type in (or paste in) the path to the .bpe file to embed:" << endl;
+    getline(cin, bpePath);
+    cout << endl
+    << "Type in the name of the embedded tokenizer (a C++ identifier, the header is written to <name>.hpp):" << endl;
+    getline(cin, name);
+
+    BPE bpe;
+    bpe.Load(bpePath);
+
+    const vector<TokenPair>& merges = bpe.merges();
+    const vector<string>& vocab = bpe.vocab();
+
+    vector<bool> splitLetterTable(256, false);
+    for(unsigned char c : bpe.splitLetters()){
+        splitLetterTable[c] = true;
+    }
+
+    /* The pair index: sorted keys for a binary search, and the token each pair merges into */
+    vector<pair<uint64_t, uint32_t>> pairs;
+    for(uint32_t i = 0; i < merges.size(); ++i){
+        uint64_t key = ((uint64_t)merges[i].token1 << 32) | merges[i].token2;
+        pairs.push_back({key, i + 256});
+    }
+    /* A pair listed twice only merges at its first rank, like BPE::Encode */
+    stable_sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b){ return a.first < b.first; });
+    pairs.erase(unique(pairs.begin(), pairs.end(), [](const auto& a, const auto& b){ return a.first == b.first; }), pairs.end());
+
+    vector<uint64_t> pairKeys;
+    vector<uint32_t> pairTokens;
+    for(const auto& [key, token] : pairs){
+        pairKeys.push_back(key);
+        pairTokens.push_back(token);
+    }
+
+    string vocabBlob;
+    vector<uint32_t> vocabOffsets;
+    for(size_t i = 0; i < bpe.vocabSize(); ++i){
+        vocabOffsets.push_back(vocabBlob.size());
+        vocabBlob.append(vocab[i]);
+    }
+    vocabOffsets.push_back(vocabBlob.size());
+
+    string headerPath = name + ".hpp";
+    ofstream file(headerPath);
+
+    if(!file.is_open()){
+        cerr << "Could not open file: " << headerPath << endl;
+        return -1;
+    }
+
+    string guard = name;
+    transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+
+    file << "/* Generated by embed.cpp from " << bpePath << ", do not edit. */\n\n"
+        << "#ifndef " << guard << "_HPP\n"
+        << "#define " << guard << "_HPP\n\n"
+        << "#include \"bpeview.hpp\"\n"
+        << "#include <array>\n\n"
+        << "namespace " << name << "{\n\n";
+
+    file << "inline constexpr char splitLetters[] = ";
+    WriteStringLiteral(file, bpe.splitLetters());
+    file << ";\n\n";
+
+    file << "inline constexpr bool lineDocuments = " << (bpe.lineDocuments() ? "true" : "false") << ";\n\n";
+
+    WriteArray(file, "bool", "splitLetterTable", splitLetterTable, [&file](bool value){ file << (value ? "true" : "false"); });
+    WriteArray(file, "TokenPair", "merges", merges, [&file](const TokenPair& pair){ file << "{" << pair.token1 << ", " << pair.token2 << "}"; });
+    WriteArray(file, "uint64_t", "pairKeys", pairKeys, [&file](uint64_t key){ file << key << "ull"; });
+    WriteArray(file, "uint32_t", "pairTokens", pairTokens, [&file](uint32_t token){ file << token; });
+    WriteArray(file, "uint32_t", "vocabOffsets", vocabOffsets, [&file](uint32_t offset){ file << offset; });
+
+    /* One string literal per token, adjacent literals are joined by the compiler */
+    file << "inline constexpr char vocabBlob[] =";
+    for(size_t i = 0; i < bpe.vocabSize(); ++i){
+        file << (i % 16 == 0 ? "\n    " : " ");
+        WriteStringLiteral(file, vocab[i]);
+    }
+    file << ";\n\n";
+
+    file << "inline constexpr BPEView bpe(\n"
+        << "    splitLetters,\n"
+        << "    splitLetterTable,\n"
+        << "    lineDocuments,\n"
+        << "    merges,\n"
+        << "    pairKeys,\n"
+        << "    pairTokens,\n"
+        << "    std::string_view(vocabBlob, sizeof(vocabBlob) - 1),\n"
+        << "    vocabOffsets\n"
+        << ");\n\n"
+        << "}\n\n"
+        << "#endif\n";
+
+    file.close();
+    cout << "Wrote " << headerPath << endl;
+}
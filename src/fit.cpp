@@ -26,9 +26,16 @@ int main(){
     string splitLetters,
     filePath,
     vocabSizeString,
-    numThreadsString;
+    lineDocumentsString,
+    numThreadsString,
+    sampleSizeString,
+    refineTopKString,
+    compareString,
+    tokensPath;
 
     int vocabSize;
+    size_t sampleSize = 0,
+    refineTopK = 0;
 
     cout << "Type in (or paste in) the letters used to split the words:" << endl;
     getline(cin, splitLetters);
@@ -41,10 +48,50 @@ int main(){
 
     vocabSize = stoi(vocabSizeString);
 
+    cout << endl
+    << "Treat every line as a separate document, so no token continues past a line break (y/N)? ";
+    getline(cin, lineDocumentsString);
+
+    bool lineDocuments = lineDocumentsString == "y" || lineDocumentsString == "Y";
+
+    cout << endl
+    << "Type in the sample size in bytes (empty for an exact fit on the whole file):" << endl;
+    getline(cin, sampleSizeString);
+
+    if(!sampleSizeString.empty()){
+        sampleSize = stoull(sampleSizeString);
+    }
+
+    if(sampleSize > 0){
+        cout << endl
+        << "Type in how many merges to refine on the whole file (empty to skip):" << endl;
+        getline(cin, refineTopKString);
+
+        if(!refineTopKString.empty()){
+            refineTopK = stoull(refineTopKString);
+        }
+
+        cout << endl
+        << "Compare with an exact fit (y/N)? ";
+        getline(cin, compareString);
+    } else {
+        cout << endl
+        << "Type in the path to write the encoded file to (empty to skip):" << endl;
+        getline(cin, tokensPath);
+    }
+
     cout << endl
         << "Split letters: " << splitLetters << endl
         << "File path: " << filePath << endl
-        << "Vocab size: " << to_string(vocabSize) << endl;
+        << "Vocab size: " << to_string(vocabSize) << endl
+        << "Line documents: " << (lineDocuments ? "yes" : "no") << endl;
+
+    if(sampleSize > 0){
+        cout << "Sample size: " << to_string(sampleSize) << " bytes" << endl
+            << "Refined merges: " << to_string(refineTopK) << endl;
+    } else if(!tokensPath.empty()){
+        cout << "Encoded file path: " << tokensPath << endl;
+    }
 
     cout << "Continue(y/N)? ";
     string continueTraining;
@@ -62,14 +109,52 @@ int main(){
     auto start = chrono::high_resolution_clock::now();
 
     bpe.LoadSplitLetters(splitLetters);
-    bpe.Fit(vocabSize,
-            filePath
-            );
+    bpe.SetLineDocuments(lineDocuments);
+    if(sampleSize > 0){
+        bpe.FitSampled(vocabSize,
+                filePath,
+                sampleSize,
+                refineTopK
+                );
+    } else {
+        bpe.Fit(vocabSize,
+                filePath,
+                tokensPath
+                );
+    }
     auto duration = chrono::duration_cast<chrono::milliseconds>(
         chrono::high_resolution_clock::now() -
         start
     );
     cout << duration.count() << "ms" << endl;
 
+    if(compareString == "y" || compareString == "Y"){
+        BPE exact;
+
+        auto exactStart = chrono::high_resolution_clock::now();
+
+        exact.LoadSplitLetters(splitLetters);
+        exact.SetLineDocuments(lineDocuments);
+        exact.Fit(vocabSize,
+                filePath
+                );
+        auto exactDuration = chrono::duration_cast<chrono::milliseconds>(
+            chrono::high_resolution_clock::now() -
+            exactStart
+        );
+
+        cout << "Exact fit: " << exactDuration.count() << "ms" << endl
+            << "Time saved: " << (exactDuration - duration).count() << "ms" << endl
+            << "Shared merges: " << bpe.MergeOverlap(exact) * 100 << "%" << endl;
+
+        /* The shared merges don't depend on their order, the size of the encoded file does */
+        cout << "Encoding the whole file with both tokenizers..." << endl;
+        size_t sampledSize = bpe.EncodedSize(filePath);
+        size_t exactSize = exact.EncodedSize(filePath);
+        cout << "Tokens (sampled fit): " << sampledSize << endl
+            << "Tokens (exact fit): " << exactSize << endl
+            << "Extra tokens: " << ((double)sampledSize / exactSize - 1) * 100 << "%" << endl;
+    }
+
     bpe.Save("tokenizer.bpe");
 }
@@ -0,0 +1,211 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef MERGE_HPP
+#define MERGE_HPP
+
+#include "datastructures.hpp"
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Words up to this many bytes are merged in a flat array on the stack, longer ones with a priority queue (0 always uses the queue) */
+#ifndef BPE_SMALL_WORD_SIZE
+#define BPE_SMALL_WORD_SIZE 32
+#endif
+
+/*
+    The merge kernels are templates on the lookups, so every tokenizer that can tell
+    the rank of a pair (and if a letter splits words) can share them:
+     - isSplitLetter(unsigned char) -> bool
+     - rank(uint32_t token1, uint32_t token2) -> the merged token, or NO_MERGE.
+       Merged tokens are numbered in merge order, so the smallest one merges first.
+     - emit(uint32_t token) gets the tokens of the text in order.
+*/
+constexpr uint32_t NO_MERGE = INT32_MAX;
+
+/* With line documents on, every line is a document: no token ever continues past the end of a line */
+constexpr unsigned char DOCUMENT_SEPARATOR = '\n';
+
+template<typename RankFn, typename EmitFn>
+inline void MergeLongWord(const unsigned char* word, const size_t size, const RankFn& rank, const EmitFn& emit){
+    /* A linked list over the word's positions: a merged token keeps the position of its left half */
+    constexpr size_t END = SIZE_MAX;
+    std::vector<uint32_t> tokens(word, word + size);
+    std::vector<size_t> prev(size), next(size);
+    std::vector<bool> removed(size, false);
+    for(size_t i = 0; i < size; ++i){
+        prev[i] = i == 0 ? END : i - 1;
+        next[i] = i + 1 == size ? END : i + 1;
+    }
+
+    /* (rank, position) of every pair, smallest rank first and leftmost on ties */
+    using Candidate = std::pair<uint32_t, size_t>;
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    auto push = [&](size_t i){
+        if(i != END && next[i] != END){
+            uint32_t merged = rank(tokens[i], tokens[next[i]]);
+            if(merged != NO_MERGE){
+                candidates.push({merged, i});
+            }
+        }
+    };
+
+    for(size_t i = 0; i + 1 < size; ++i){
+        push(i);
+    }
+
+    while(!candidates.empty()){
+        auto [merged, i] = candidates.top();
+        candidates.pop();
+
+        /* Merges around a pair change its tokens, so old candidates are skipped when they don't match anymore */
+        if(removed[i] || next[i] == END || rank(tokens[i], tokens[next[i]]) != merged){
+            continue;
+        }
+
+        size_t right = next[i];
+        tokens[i] = merged;
+        removed[right] = true;
+        next[i] = next[right];
+        if(next[i] != END){
+            prev[next[i]] = i;
+        }
+
+        push(prev[i]);
+        push(i);
+    }
+
+    for(size_t i = 0; i != END; i = next[i]){
+        emit(tokens[i]);
+    }
+}
+
+#if BPE_SMALL_WORD_SIZE > 0
+static_assert(BPE_SMALL_WORD_SIZE % 4 == 0 && BPE_SMALL_WORD_SIZE < NO_MERGE);
+
+/* Index of the first smallest rank, ranks must be padded with NO_MERGE up to a multiple of 4 */
+inline size_t MinRankIdx(const uint32_t* ranks, const size_t count){
+#if defined(__SSE2__)
+    /* Ranks fit in 31 bits, so signed compares are fine */
+    __m128i best = _mm_set1_epi32(NO_MERGE);
+    for(size_t i = 0; i < count; i += 4){
+        __m128i chunk = _mm_load_si128((const __m128i*)(ranks + i));
+        __m128i smaller = _mm_cmplt_epi32(chunk, best);
+        best = _mm_or_si128(_mm_and_si128(smaller, chunk), _mm_andnot_si128(smaller, best));
+    }
+
+    /* Minimum across the lanes: swap the halves, then the neighbours */
+    __m128i swapped = _mm_shuffle_epi32(best, _MM_SHUFFLE(1, 0, 3, 2));
+    __m128i smaller = _mm_cmplt_epi32(swapped, best);
+    best = _mm_or_si128(_mm_and_si128(smaller, swapped), _mm_andnot_si128(smaller, best));
+    swapped = _mm_shuffle_epi32(best, _MM_SHUFFLE(2, 3, 0, 1));
+    smaller = _mm_cmplt_epi32(swapped, best);
+    best = _mm_or_si128(_mm_and_si128(smaller, swapped), _mm_andnot_si128(smaller, best));
+
+    const __m128i minimum = _mm_shuffle_epi32(best, 0);
+    for(size_t i = 0; i < count; i += 4){
+        __m128i chunk = _mm_load_si128((const __m128i*)(ranks + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(chunk, minimum)));
+        if(mask != 0){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return 0;
+#else
+    size_t best = 0;
+    for(size_t i = 1; i < count; ++i){
+        if(ranks[i] < ranks[best]){
+            best = i;
+        }
+    }
+    return best;
+#endif
+}
+
+template<typename RankFn, typename EmitFn>
+inline void MergeSmallWord(const unsigned char* word, const size_t size, const RankFn& rank, const EmitFn& emit){
+    alignas(16) uint32_t tokens[BPE_SMALL_WORD_SIZE];
+    /* ranks[i] is the rank of tokens[i] with tokens[i+1] */
+    alignas(16) uint32_t ranks[BPE_SMALL_WORD_SIZE];
+
+    for(size_t i = 0; i < size; ++i){
+        tokens[i] = word[i];
+    }
+    for(size_t i = 0; i < BPE_SMALL_WORD_SIZE; ++i){
+        ranks[i] = NO_MERGE;
+    }
+    for(size_t i = 0; i + 1 < size; ++i){
+        ranks[i] = rank(tokens[i], tokens[i+1]);
+    }
+
+    size_t count = size;
+    while(count > 1){
+        size_t i = MinRankIdx(ranks, count - 1);
+        if(ranks[i] == NO_MERGE){
+            break;
+        }
+
+        tokens[i] = ranks[i];
+        memmove(tokens + i + 1, tokens + i + 2, (count - i - 2) * sizeof(uint32_t));
+        memmove(ranks + i + 1, ranks + i + 2, (count - i - 2) * sizeof(uint32_t));
+        --count;
+        ranks[count - 1] = NO_MERGE;
+
+        if(i > 0){
+            ranks[i - 1] = rank(tokens[i - 1], tokens[i]);
+        }
+        if(i + 1 < count){
+            ranks[i] = rank(tokens[i], tokens[i + 1]);
+        }
+    }
+
+    for(size_t i = 0; i < count; ++i){
+        emit(tokens[i]);
+    }
+}
+#endif
+
+/* Words start at each split letter (and after each document separator with line documents on), and merges never cross words */
+template<typename SplitFn, typename RankFn, typename EmitFn>
+inline void MergeText(const std::string_view text, const SplitFn& isSplitLetter, const bool lineDocuments, const RankFn& rank, const EmitFn& emit){
+    const unsigned char* data = (const unsigned char*)text.data();
+    size_t wordStart = 0;
+    for(size_t i = 1; i <= text.size(); ++i){
+        if(i < text.size() && !isSplitLetter(data[i]) && !(lineDocuments && data[i-1] == DOCUMENT_SEPARATOR)){
+            continue;
+        }
+
+#if BPE_SMALL_WORD_SIZE > 0
+        if(i - wordStart <= BPE_SMALL_WORD_SIZE){
+            MergeSmallWord(data + wordStart, i - wordStart, rank, emit);
+        } else
+#endif
+        {
+            MergeLongWord(data + wordStart, i - wordStart, rank, emit);
+        }
+        wordStart = i;
+    }
+}
+
+#endif
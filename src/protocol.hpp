@@ -0,0 +1,93 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Every message is a fixed header followed by `length` bytes of payload (native byte order, local only) */
+enum class Op : uint8_t{
+    Encode = 0, /* text -> uint32 tokens */
+    Decode = 1, /* uint32 tokens -> text */
+    Count = 2,  /* text -> one uint32 token count */
+    Stats = 3,  /* nothing -> stats text */
+    Reload = 4  /* tokenizer path (empty for the one the server started with) -> nothing */
+};
+
+enum class Status : uint8_t{
+    Ok = 0,
+    Error = 1   /* payload is the error message */
+};
+
+struct RequestHeader{
+    uint32_t id;
+    Op op;
+    uint8_t padding[3];
+    uint32_t length;
+};
+
+struct ResponseHeader{
+    uint32_t id;
+    Status status;
+    uint8_t padding[3];
+    uint32_t length;
+};
+
+static_assert(sizeof(RequestHeader) == 12 && sizeof(ResponseHeader) == 12);
+
+/* Payloads above this size are refused so a broken client can't make the server allocate anything */
+constexpr uint32_t MAX_PAYLOAD_SIZE = 64 << 20;
+
+inline bool ReadAll(int fd, void* buffer, size_t size){
+    char* data = (char*)buffer;
+    while(size > 0){
+        ssize_t n = read(fd, data, size);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+inline bool WriteAll(int fd, const void* buffer, size_t size){
+    const char* data = (const char*)buffer;
+    while(size > 0){
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+#endif
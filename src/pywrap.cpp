@@ -19,6 +19,7 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include "bpe.hpp"
+#include "streamdecoder.hpp"
 
 namespace py = pybind11;
 
@@ -27,10 +28,16 @@ PYBIND11_MODULE(pybpe, m) {
     py::class_<BPE>(m, "BPE")
         .def(py::init<>())
         .def("load_split_letters", &BPE::LoadSplitLetters)
+        .def("set_line_documents", &BPE::SetLineDocuments)
         .def("load", &BPE::Load)
         .def("encode", &BPE::EncodeToVector)
+        .def("count", &BPE::Count)
         .def("decode", &BPE::DecodeFromVector)
-        .def("fit", &BPE::Fit)
+        .def("fit", &BPE::Fit, py::arg("vocab_size"), py::arg("path"), py::arg("tokens_path") = "")
         .def("save", &BPE::Save);
+    py::class_<StreamDecoder>(m, "StreamDecoder")
+        .def(py::init<const BPE&>(), py::keep_alive<1, 2>())
+        .def("decode", &StreamDecoder::Decode)
+        .def("flush", &StreamDecoder::Flush);
 }
 
@@ -0,0 +1,343 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "protocol.hpp"
+#include "tokenizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <sys/un.h>
+
+using namespace std;
+
+constexpr size_t MAX_BATCH_SIZE = 64;
+constexpr size_t LATENCY_WINDOW = 8192;
+
+struct Connection{
+    int fd;
+    mutex writeMutex;
+
+    inline Connection(int fd):fd(fd){}
+    inline ~Connection(){ close(fd); }
+};
+
+struct Request{
+    shared_ptr<Connection> connection;
+    RequestHeader header;
+    string payload;
+    chrono::steady_clock::time_point received;
+};
+
+class RequestQueue{
+private:
+    deque<Request> m_Requests;
+    mutex m_Mutex;
+    condition_variable m_NotEmpty;
+    size_t m_MaxDepth = 0;
+    const size_t m_NumWorkers;
+
+public:
+    inline explicit RequestQueue(size_t numWorkers):m_NumWorkers(max<size_t>(1, numWorkers)){}
+
+    inline void Push(Request&& request){
+        {
+            lock_guard lock(m_Mutex);
+            m_Requests.push_back(std::move(request));
+            m_MaxDepth = max(m_MaxDepth, m_Requests.size());
+        }
+        m_NotEmpty.notify_one();
+    }
+
+    /*
+        Waits for at least one request, then takes this worker's share of the queue (up to MAX_BATCH_SIZE),
+        so a burst is spread over the pool instead of being handled by the first worker that wakes up
+    */
+    inline void PopBatch(vector<Request>& batch){
+        batch.clear();
+        unique_lock lock(m_Mutex);
+        m_NotEmpty.wait(lock, [this]{ return !m_Requests.empty(); });
+
+        const size_t share = min(MAX_BATCH_SIZE, (m_Requests.size() + m_NumWorkers - 1) / m_NumWorkers);
+        while(batch.size() < share){
+            batch.push_back(std::move(m_Requests.front()));
+            m_Requests.pop_front();
+        }
+        const bool left = !m_Requests.empty();
+        lock.unlock();
+
+        /* The wakeups of the requests left may have gone to busy workers */
+        if(left){
+            m_NotEmpty.notify_one();
+        }
+    }
+
+    inline void Depth(size_t& depth, size_t& maxDepth){
+        lock_guard lock(m_Mutex);
+        depth = m_Requests.size();
+        maxDepth = m_MaxDepth;
+    }
+};
+
+class Stats{
+private:
+    mutex m_Mutex;
+    vector<uint64_t> m_Latencies;
+    size_t m_NextLatency = 0;
+    uint64_t m_Requests = 0;
+    uint64_t m_Batches = 0;
+
+public:
+    inline void RecordBatch(const vector<Request>& batch){
+        auto now = chrono::steady_clock::now();
+
+        lock_guard lock(m_Mutex);
+        for(const Request& request : batch){
+            uint64_t latency = chrono::duration_cast<chrono::microseconds>(now - request.received).count();
+            if(m_Latencies.size() < LATENCY_WINDOW){
+                m_Latencies.push_back(latency);
+            } else {
+                m_Latencies[m_NextLatency] = latency;
+            }
+            m_NextLatency = (m_NextLatency + 1) % LATENCY_WINDOW;
+        }
+        m_Requests += batch.size();
+        ++m_Batches;
+    }
+
+    /* Latency percentiles are over the last LATENCY_WINDOW requests, from receiving to answering */
+    inline string Report(RequestQueue& queue){
+        vector<uint64_t> latencies;
+        uint64_t requests, batches;
+        {
+            lock_guard lock(m_Mutex);
+            latencies = m_Latencies;
+            requests = m_Requests;
+            batches = m_Batches;
+        }
+
+        size_t depth, maxDepth;
+        queue.Depth(depth, maxDepth);
+
+        auto percentile = [&latencies](double p) -> uint64_t {
+            if(latencies.empty()){
+                return 0;
+            }
+            size_t idx = min(latencies.size() - 1, (size_t)(p * latencies.size()));
+            nth_element(latencies.begin(), latencies.begin() + idx, latencies.end());
+            return latencies[idx];
+        };
+
+        stringstream report;
+        report << "requests " << requests
+            << " batches " << batches
+            << " queue_depth " << depth
+            << " max_queue_depth " << maxDepth
+            << " p50_us " << percentile(0.5)
+            << " p90_us " << percentile(0.9)
+            << " p99_us " << percentile(0.99);
+        return report.str();
+    }
+};
+
+struct Server{
+    TokenizerHandle tokenizer;
+    string tokenizerPath;
+    RequestQueue queue;
+    Stats stats;
+
+    inline Server(shared_ptr<const Tokenizer> tokenizer, const string& tokenizerPath, size_t numWorkers):
+        tokenizer(std::move(tokenizer)), tokenizerPath(tokenizerPath), queue(numWorkers){}
+};
+
+void ReloadTokenizer(Server& server, const string& path, Status& status, string& response){
+    const string& tokenizerPath = path.empty() ? server.tokenizerPath : path;
+
+    /* A missing or broken file is reported to the client, the server keeps the tokenizer it has */
+    string error;
+    if(!server.tokenizer.TryReload(tokenizerPath, error)){
+        status = Status::Error;
+        response = "Could not load " + tokenizerPath + ": " + error;
+        return;
+    }
+
+    cout << "Reloaded " << tokenizerPath << endl;
+}
+
+void HandleRequest(Server& server, const Tokenizer& tokenizer, const Request& request, Status& status, string& response){
+    status = Status::Ok;
+    switch(request.header.op){
+        case Op::Encode: {
+            vector<uint32_t> tokens = tokenizer.EncodeToVector(request.payload);
+            response.assign((const char*)tokens.data(), tokens.size() * sizeof(uint32_t));
+            return;
+        }
+        case Op::Decode: {
+            if(request.payload.size() % sizeof(uint32_t) != 0){
+                break;
+            }
+            vector<uint32_t> tokens(request.payload.size() / sizeof(uint32_t));
+            memcpy(tokens.data(), request.payload.data(), request.payload.size());
+            for(uint32_t token : tokens){
+                if(token >= tokenizer.vocabSize()){
+                    status = Status::Error;
+                    response = "Invalid token: " + to_string(token);
+                    return;
+                }
+            }
+            response = tokenizer.DecodeFromVector(tokens);
+            return;
+        }
+        case Op::Count: {
+            uint32_t count = tokenizer.Count(request.payload);
+            response.assign((const char*)&count, sizeof(count));
+            return;
+        }
+        case Op::Stats: {
+            response = server.stats.Report(server.queue);
+            return;
+        }
+        case Op::Reload: {
+            response.clear();
+            ReloadTokenizer(server, request.payload, status, response);
+            return;
+        }
+    }
+
+    status = Status::Error;
+    response = "Invalid request";
+}
+
+void Worker(Server& server){
+    vector<Request> batch;
+    /* Responses of one batch are written to each connection at once */
+    vector<pair<shared_ptr<Connection>, string>> outputs;
+    string response;
+
+    while(true){
+        server.queue.PopBatch(batch);
+
+        /* A reload during the batch only affects the next batches */
+        shared_ptr<const Tokenizer> tokenizer = server.tokenizer.Get();
+
+        outputs.clear();
+        for(const Request& request : batch){
+            Status status;
+            HandleRequest(server, *tokenizer, request, status, response);
+
+            auto output = find_if(outputs.begin(), outputs.end(), [&request](const auto& output){
+                return output.first == request.connection;
+            });
+            if(output == outputs.end()){
+                outputs.push_back({request.connection, string()});
+                output = outputs.end() - 1;
+            }
+
+            ResponseHeader header{.id=request.header.id, .status=status, .padding={}, .length=(uint32_t)response.size()};
+            output->second.append((const char*)&header, sizeof(header));
+            output->second.append(response);
+        }
+
+        for(const auto& [connection, data] : outputs){
+            lock_guard lock(connection->writeMutex);
+            WriteAll(connection->fd, data.data(), data.size());
+        }
+
+        server.stats.RecordBatch(batch);
+    }
+}
+
+void ReadRequests(shared_ptr<Connection> connection, RequestQueue& queue){
+    while(true){
+        Request request;
+        if(!ReadAll(connection->fd, &request.header, sizeof(request.header))){
+            break;
+        }
+
+        if(request.header.length > MAX_PAYLOAD_SIZE){
+            cerr << "Payload too big, closing connection." << endl;
+            break;
+        }
+
+        request.payload.resize(request.header.length);
+        if(!ReadAll(connection->fd, request.payload.data(), request.payload.size())){
+            break;
+        }
+
+        request.connection = connection;
+        request.received = chrono::steady_clock::now();
+        queue.Push(std::move(request));
+    }
+}
+
+int main(int argc, char** argv){
+    string tokenizerPath = argc > 1 ? argv[1] : "tokenizer.bpe";
+    string socketPath = argc > 2 ? argv[2] : "bpe.sock";
+    size_t numThreads = argc > 3 ? stoul(argv[3]) : max(1u, thread::hardware_concurrency());
+
+    Server server(Tokenizer::Load(tokenizerPath), tokenizerPath, numThreads);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if(listener < 0 || socketPath.size() >= sizeof(address.sun_path)){
+        cerr << "Could not create socket: " << socketPath << endl;
+        exit(-1);
+    }
+
+    socketPath.copy(address.sun_path, socketPath.size());
+    unlink(socketPath.c_str());
+
+    if(bind(listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0){
+        cerr << "Could not listen on socket: " << socketPath << endl;
+        exit(-1);
+    }
+
+    for(size_t i = 0; i < numThreads; ++i){
+        thread(Worker, ref(server)).detach();
+    }
+
+    thread([&server]{
+        while(true){
+            this_thread::sleep_for(chrono::seconds(10));
+            cout << server.stats.Report(server.queue) << endl;
+        }
+    }).detach();
+
+    cout << "Listening on " << socketPath << " with " << numThreads << " workers." << endl;
+
+    while(true){
+        int client = accept(listener, nullptr, nullptr);
+        if(client < 0){
+            if(errno != EINTR){
+                cerr << "Could not accept connection." << endl;
+            }
+            continue;
+        }
+
+        thread(ReadRequests, make_shared<Connection>(client), ref(server.queue)).detach();
+    }
+}
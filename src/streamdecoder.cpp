@@ -0,0 +1,93 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "streamdecoder.hpp"
+
+using namespace std;
+
+static const char REPLACEMENT_CHARACTER[] = "\xEF\xBF\xBD";
+
+void StreamDecoder::PushByte(const unsigned char c, string& output){
+    if(m_PendingSize > 0){
+        /* Same ranges as python's decoder: no overlong encodings, surrogates or characters over U+10FFFF */
+        unsigned char low = 0x80, high = 0xBF;
+        if(m_PendingSize == 1){
+            switch(m_Pending[0]){
+                case 0xE0: low = 0xA0; break;
+                case 0xED: high = 0x9F; break;
+                case 0xF0: low = 0x90; break;
+                case 0xF4: high = 0x8F; break;
+            }
+        }
+
+        if(c >= low && c <= high){
+            m_Pending[m_PendingSize++] = c;
+            if(m_PendingSize == m_Expected){
+                output.append((const char*)m_Pending, m_PendingSize);
+                m_PendingSize = 0;
+            }
+            return;
+        }
+
+        /* The character was cut short: replace it and read this byte as the start of a new one */
+        output.append(REPLACEMENT_CHARACTER);
+        m_PendingSize = 0;
+    }
+
+    if(c < 0x80){
+        output.push_back(c);
+        return;
+    }
+
+    if(c >= 0xC2 && c <= 0xDF){
+        m_Expected = 2;
+    } else if(c >= 0xE0 && c <= 0xEF){
+        m_Expected = 3;
+    } else if(c >= 0xF0 && c <= 0xF4){
+        m_Expected = 4;
+    } else {
+        output.append(REPLACEMENT_CHARACTER);
+        return;
+    }
+
+    m_Pending[0] = c;
+    m_PendingSize = 1;
+}
+
+string StreamDecoder::Decode(const uint32_t token){
+    string output;
+    if(token >= m_BPE.vocabSize()){
+        output = Flush();
+        output.append(REPLACEMENT_CHARACTER);
+        return output;
+    }
+
+    for(unsigned char c : m_BPE.vocab()[token]){
+        PushByte(c, output);
+    }
+    return output;
+}
+
+string StreamDecoder::Flush(){
+    string output;
+    if(m_PendingSize > 0){
+        output.append(REPLACEMENT_CHARACTER);
+        m_PendingSize = 0;
+    }
+    return output;
+}
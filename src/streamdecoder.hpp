@@ -0,0 +1,45 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMDECODER_HPP
+#define STREAMDECODER_HPP
+
+#include "bpe.hpp"
+#include <string>
+
+/*
+    Decodes tokens one at a time (for example while generating text).
+    Only complete utf-8 characters are returned, the bytes of a character split across tokens are held until it is complete.
+    Invalid bytes (and invalid tokens) become U+FFFD, so the output is always valid utf-8.
+*/
+class StreamDecoder{
+private:
+    const BPE& m_BPE;
+    unsigned char m_Pending[4];
+    uint8_t m_PendingSize;
+    uint8_t m_Expected;
+
+    void PushByte(const unsigned char c, std::string& output);
+public:
+    inline StreamDecoder(const BPE& bpe):m_BPE(bpe), m_PendingSize(0), m_Expected(0){}
+
+    std::string Decode(const uint32_t token);
+    std::string Flush();
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*
+    bpe.cpp - A simple, fast and multithreaded Byte Pair Encoder written in c++ with python bindings.
+    Copyright (C) 2024  Lorenzo Amos Sanzullo
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOKENIZER_HPP
+#define TOKENIZER_HPP
+
+#include "bpe.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+
+/* A BPE that can't change anymore: only const methods are reachable, so one instance can be shared between threads */
+class Tokenizer{
+private:
+    const BPE m_BPE;
+
+public:
+    inline explicit Tokenizer(BPE bpe):m_BPE(std::move(bpe)){}
+
+    inline static std::shared_ptr<const Tokenizer> Load(const std::string& path){
+        BPE bpe;
+        bpe.Load(path);
+        return std::make_shared<const Tokenizer>(std::move(bpe));
+    }
+
+    /* Like Load, but a missing or broken file gives back nullptr and the reason instead of exiting */
+    inline static std::shared_ptr<const Tokenizer> TryLoad(const std::string& path, std::string& error){
+        BPE bpe;
+        if(!bpe.TryLoad(path, error)){
+            return nullptr;
+        }
+        return std::make_shared<const Tokenizer>(std::move(bpe));
+    }
+
+    inline const BPE& bpe() const { return m_BPE; }
+    inline size_t vocabSize() const { return m_BPE.vocabSize(); }
+
+    inline TokenList Encode(const std::string& text) const { return m_BPE.Encode(text); }
+    inline std::vector<uint32_t> EncodeToVector(const std::string& text) const { return m_BPE.EncodeToVector(text); }
+    inline size_t Count(const std::string& text) const { return m_BPE.Count(text); }
+    inline std::string Decode(const TokenList& tokens) const { return m_BPE.Decode(tokens); }
+    inline std::string DecodeFromVector(const std::vector<uint32_t>& tokens) const { return m_BPE.DecodeFromVector(tokens); }
+};
+
+/*
+    Points to the current Tokenizer. Get the pointer once per request and use it until the request is done:
+    Reload swaps in a new tokenizer for the next requests, while the old one lives until its last request finishes.
+*/
+class TokenizerHandle{
+private:
+    std::atomic<std::shared_ptr<const Tokenizer>> m_Current;
+
+public:
+    inline explicit TokenizerHandle(std::shared_ptr<const Tokenizer> tokenizer):m_Current(std::move(tokenizer)){}
+
+    inline std::shared_ptr<const Tokenizer> Get() const { return m_Current.load(); }
+    inline void Store(std::shared_ptr<const Tokenizer> tokenizer){ m_Current.store(std::move(tokenizer)); }
+
+    /* The new tokenizer is fully loaded before the swap, so requests never wait for the load */
+    inline void Reload(const std::string& path){ Store(Tokenizer::Load(path)); }
+
+    /* Keeps the current tokenizer if the new one can't be loaded */
+    inline bool TryReload(const std::string& path, std::string& error){
+        std::shared_ptr<const Tokenizer> tokenizer = Tokenizer::TryLoad(path, error);
+        if(!tokenizer){
+            return false;
+        }
+        Store(std::move(tokenizer));
+        return true;
+    }
+};
+
+#endif